@@ -0,0 +1,64 @@
+/* liblasertank: batched Laser Tank environments behind a plain C API.
+ *
+ * Build (from the repository root):
+ *   g++ -std=c++17 -O2 -mavx2 -shared -fPIC -fvisibility=hidden \
+ *       -DLASERTANK_LIBRARY -o liblasertank.so a.cpp -pthread
+ *
+ * All buffers belong to the caller and are written in place; the library
+ * does not allocate after lt_create.
+ *
+ *   observations  uint8  [batch][lt_plane_count][rows * cols]
+ *       plane 0                 mirror orientation (0 none, 1 '/', 2 '\')
+ *       plane 1                 mirror health
+ *       planes 2 .. 1+P         tanks, starting with the player to move
+ *       planes 2+P .. 1+2P      laser sources, same player order
+ *       plane 2+2P              cells crossed by the last laser
+ *   actions       int32  [batch]  index in [0, lt_action_count)
+ *   legal mask    uint8  [batch][lt_action_count]
+ *   rewards       float  [batch]  +1 / -1 for the mover when the game ends
+ *   dones         uint8  [batch]  game ended; the slot already holds a new game
+ *
+ * Action index: 0 passes. Then, for laser H and then laser V, a block of
+ * 1 + 17 * cells entries: no action, rotate mirror at cell,
+ * move (cell * 8 + dir - 1), shoot (cell * 8 + dir - 1).
+ */
+#ifndef LASERTANK_H
+#define LASERTANK_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define LT_API __declspec(dllexport)
+#else
+#define LT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct lt_env lt_env;
+
+    /* NULL when the settings are out of range (4..10 cells a side, 2..8 players). */
+    LT_API lt_env *lt_create(int batch, uint64_t seed, int rows, int cols, int players, int tanks_per_player);
+    LT_API void lt_destroy(lt_env *env);
+
+    LT_API int lt_batch_size(const lt_env *env);
+    LT_API int lt_action_count(const lt_env *env);
+    LT_API int lt_plane_count(const lt_env *env);
+
+    /* Restart every game from the creation seed, in place; observations may be NULL. */
+    LT_API void lt_reset(lt_env *env, uint8_t *observations);
+
+    /* One turn for every game; any output pointer may be NULL. */
+    LT_API void lt_step(lt_env *env, const int32_t *actions, uint8_t *observations, float *rewards, uint8_t *dones);
+
+    LT_API void lt_legal_mask(lt_env *env, uint8_t *mask);
+    LT_API void lt_current_players(const lt_env *env, int32_t *players);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif